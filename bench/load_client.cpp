@@ -0,0 +1,89 @@
+// Simple closed-loop HTTP load generator for the benchmark scripts
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/asio.hpp>
+#include <fmt/core.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+// Usage: load_client <target> [connections] [requests] [port]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fmt::print("Usage: {} <target> [connections] [requests] [port]\n", argv[0]);
+        return 1;
+    }
+
+    std::string target = argv[1];
+    int connections = argc > 2 ? std::stoi(argv[2]) : 8;
+    int requests = argc > 3 ? std::stoi(argv[3]) : 10000;
+    std::string port = argc > 4 ? argv[4] : "63090";
+
+    std::atomic<int> next{0};
+    std::atomic<int> failures{0};   // Connect/read/write errors
+    std::atomic<int> non2xx{0};     // Responses outside 2xx, e.g. routes missing after a reload
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < connections; ++i) {
+        workers.emplace_back([&, i]() {
+            net::io_context ioc;
+            tcp::resolver resolver(ioc);
+            auto endpoints = resolver.resolve("127.0.0.1", port);
+
+            // The server closes after each response, so every request is a new connection
+            while (next.fetch_add(1) < requests) {
+                auto begin = std::chrono::steady_clock::now();
+                try {
+                    tcp::socket socket(ioc);
+                    net::connect(socket, endpoints);
+
+                    http::request<http::empty_body> req{http::verb::get, target, 11};
+                    req.set(http::field::host, "localhost");
+                    http::write(socket, req);
+
+                    beast::flat_buffer buffer;
+                    http::response<http::string_body> res;
+                    http::read(socket, buffer, res);
+                    if (res.result_int() < 200 || res.result_int() >= 300) {
+                        ++non2xx;
+                        continue;
+                    }
+                } catch (const std::exception&) {
+                    ++failures;
+                    continue;
+                }
+                // Only successful responses count, so fast refusals cannot inflate rps or hide in p99
+                latencies[i].push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - begin).count());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<std::size_t>(p * all.size()))];
+    };
+
+    fmt::print("requests={} ok={} failures={} non_2xx={} seconds={:.3f} rps={:.0f} p50_us={:.0f} p99_us={:.0f}\n",
+        requests, all.size(), failures.load(), non2xx.load(), seconds, all.size() / seconds,
+        percentile(0.50), percentile(0.99));
+    return failures.load() == 0 && non2xx.load() == 0 ? 0 : 2;
+}
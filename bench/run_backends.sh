@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+# Compare the io_uring and epoll server builds: throughput, p99 and syscalls per request.
+#
+# Usage: bench/run_backends.sh <build-bin-dir> [target] [connections] [requests]
+# Configure with -DHOT_RELOAD_IO_URING=ON -DHOT_RELOAD_BENCH=ON so that bin/ holds
+# server (io_uring), server_epoll and load_client. Without io_uring only epoll is measured.
+set -euo pipefail
+
+BIN_DIR=$(cd "${1:?usage: $0 <build-bin-dir> [target] [connections] [requests]}" && pwd)
+TARGET=${2:-/static/bench.txt}
+CONNECTIONS=${3:-8}
+REQUESTS=${4:-20000}
+PORT=63090
+
+# Default target is a small static file, which exercises socket and file I/O
+mkdir -p "$BIN_DIR/static"
+[ -f "$BIN_DIR/static/bench.txt" ] || head -c 4096 /dev/zero | tr '\0' 'x' > "$BIN_DIR/static/bench.txt"
+
+# Run a load of the given size while tracer ($3...) watches pid; leaves the tracer's log in $log
+trace_load() {
+    local requests=$1 log=$2
+    shift 2
+    "$@" -o "$log" &
+    local tracer=$!
+    sleep 1
+    if ! kill -0 "$tracer" 2>/dev/null; then
+        return 1
+    fi
+    "$BIN_DIR/load_client" "$TARGET" "$CONNECTIONS" "$requests" "$PORT" >/dev/null || true
+    kill -INT "$tracer"
+    wait "$tracer" 2>/dev/null || true
+}
+
+# Count syscalls of a running pid while the load runs; prints the total.
+# Prefers perf and falls back to strace when perf is missing or cannot attach.
+count_syscalls() {
+    local pid=$1 requests=$2 log count=""
+    log=$(mktemp)
+    if command -v perf >/dev/null &&
+        trace_load "$requests" "$log" perf stat -x, -e raw_syscalls:sys_enter -p "$pid"; then
+        count=$(awk -F, '/raw_syscalls/ && $1 ~ /^[0-9]+$/ { print $1 }' "$log")
+    fi
+    if [ -z "$count" ] && command -v strace >/dev/null &&
+        trace_load "$requests" "$log" strace -c -f -p "$pid"; then
+        # Columns can be blank (e.g. no errors), so read "calls" by its position in the header
+        count=$(awk '/calls/ && /syscall/ { end = index($0, "calls") + 4 }
+                     end && $NF == "total" { n = split(substr($0, 1, end), f, " "); print f[n] }' "$log")
+    fi
+    rm -f "$log"
+    echo "${count:-n/a}"
+}
+
+run_backend() {
+    local name=$1 binary=$2
+    [ -x "$BIN_DIR/$binary" ] || return 0
+
+    (cd "$BIN_DIR" && exec "./$binary" >/dev/null 2>&1) &
+    local pid=$!
+    sleep 2
+
+    local result syscalls per_request="n/a"
+    result=$("$BIN_DIR/load_client" "$TARGET" "$CONNECTIONS" "$REQUESTS" "$PORT" || true)
+
+    # Separate, shorter run for syscall counts since tracing skews throughput
+    syscalls=$(count_syscalls "$pid" $((REQUESTS / 10)))
+    if [[ "$syscalls" =~ ^[0-9]+$ ]]; then
+        per_request=$(awk -v s="$syscalls" -v r=$((REQUESTS / 10)) 'BEGIN { printf "%.1f", s / r }')
+    fi
+
+    kill "$pid"
+    wait "$pid" 2>/dev/null || true
+    printf '%-10s %s syscalls_per_request=%s\n' "$name" "$result" "$per_request"
+}
+
+# server is the io_uring build only when its epoll sibling was built alongside it
+if [ -x "$BIN_DIR/server_epoll" ]; then
+    run_backend io_uring server
+    run_backend epoll server_epoll
+else
+    run_backend epoll server
+fi
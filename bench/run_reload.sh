@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# Throughput and p99 while the plugin is replaced mid-run: in-process reload vs prefork rolling reload.
+#
+# Usage: bench/run_reload.sh <build-bin-dir> [workers] [target] [connections] [requests]
+# Configure with -DHOT_RELOAD_BENCH=ON so that bin/ holds load_client.
+set -euo pipefail
+
+BIN_DIR=$(cd "${1:?usage: $0 <build-bin-dir> [workers] [target] [connections] [requests]}" && pwd)
+WORKERS=${2:-4}
+TARGET=${3:-/hello}
+CONNECTIONS=${4:-8}
+REQUESTS=${5:-50000}
+PORT=63090
+
+case "$(uname)" in
+    Darwin) PLUGIN=libmanager.dylib ;;
+    *)      PLUGIN=libmanager.so ;;
+esac
+cp "$BIN_DIR/$PLUGIN" "$BIN_DIR/.$PLUGIN.orig"
+trap 'mv -f "$BIN_DIR/.$PLUGIN.orig" "$BIN_DIR/$PLUGIN"' EXIT
+
+# Swap in a byte-different copy of the plugin the way a linker would: new file, then rename
+touch_plugin() {
+    cp "$BIN_DIR/.$PLUGIN.orig" "$BIN_DIR/.$PLUGIN.next"
+    printf '%s' "$1" >> "$BIN_DIR/.$PLUGIN.next"
+    mv -f "$BIN_DIR/.$PLUGIN.next" "$BIN_DIR/$PLUGIN"
+}
+
+run_mode() {
+    local name=$1
+    shift
+    (cd "$BIN_DIR" && exec ./server "$@" >/dev/null 2>&1) &
+    local pid=$!
+    sleep 3
+
+    "$BIN_DIR/load_client" "$TARGET" "$CONNECTIONS" "$REQUESTS" "$PORT" > "$BIN_DIR/.reload_result" || true &
+    local load=$!
+    sleep 1
+    touch_plugin "$name"
+    wait "$load" || true
+
+    kill "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+    printf '%-10s %s\n' "$name" "$(cat "$BIN_DIR/.reload_result")"
+    rm -f "$BIN_DIR/.reload_result"
+    cp "$BIN_DIR/.$PLUGIN.orig" "$BIN_DIR/$PLUGIN"
+}
+
+run_mode in-process
+run_mode prefork --workers "$WORKERS"
@@ -51,4 +51,28 @@ public:
                                     std::string_view body = "") = 0;
 };
 
-extern "C" EXPORT Plugin* createPlugin(); 
\ No newline at end of file
+extern "C" EXPORT Plugin* createPlugin();
+
+#ifndef _WIN32
+#include <dlfcn.h>
+
+// Load a component library and report it to the host, which tracks load addresses for profiling
+inline void* loadComponent(const char* path, int flags = RTLD_NOW) {
+    void* handle = dlopen(path, flags);
+    if (handle) {
+        using Hook = void (*)(void*, const char*);
+        if (auto hook = reinterpret_cast<Hook>(dlsym(RTLD_DEFAULT, "hotReloadComponentLoaded"))) {
+            hook(handle, path);
+        }
+    }
+    return handle;
+}
+
+// False when the host rolls out component changes itself (prefork workers), so routers
+// must not swap in endpoints from disk on their own
+inline bool componentHotSwapEnabled() {
+    using Query = bool (*)();
+    auto query = reinterpret_cast<Query>(dlsym(RTLD_DEFAULT, "hotReloadComponentHotSwap"));
+    return !query || query();
+}
+#endif 
\ No newline at end of file
@@ -67,7 +67,7 @@ private:
     void loadController(const std::filesystem::path& path) {
         fmt::print("Loading controller: {}\n", path.string());
         
-        void* handle = dlopen(path.c_str(), RTLD_NOW);
+        void* handle = loadComponent(path.c_str(), RTLD_NOW);
         if (!handle) {
             fmt::print("Failed to load controller: {}\n", dlerror());
             return;
@@ -0,0 +1,476 @@
+#pragma once
+// On-demand sampling profiler served at /debug/profile (Linux only).
+// CPU mode samples every thread with ITIMER_PROF/SIGPROF; heap mode samples allocations
+// made through operator new. Nothing runs while no profile is active: the timer is
+// disarmed and the allocation hook is a single relaxed load.
+#include <fmt/core.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <link.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+// Remembers every component library loaded through loadComponent(), with a snapshot of
+// its exported function symbols taken while it was mapped. Samples can then be
+// symbolized even after the library was unloaded or reloaded at the same address.
+class ComponentRegistry {
+public:
+    static ComponentRegistry& instance() {
+        static ComponentRegistry registry;
+        return registry;
+    }
+
+    // Bumped on every new registration; samples record it to pick the right generation
+    std::uint32_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+    // Record a freshly loaded library by its dlopen handle
+    void add(void* handle, const std::string& path) {
+        link_map* map = nullptr;
+        if (!handle || dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0 || !map) {
+            return;
+        }
+
+        Module module;
+        module.path = path;
+        module.base = map->l_addr;
+        snapshot(module);
+        if (module.ranges.empty()) {
+            return;
+        }
+        module.inode = mappedInode(module.ranges.front().first);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // dlopen of an already loaded library hands back the same mapping
+        for (auto it = modules_.rbegin(); it != modules_.rend(); ++it) {
+            if (it->base == module.base && it->path == module.path) {
+                if (it->inode == module.inode) {
+                    return;
+                }
+                break;
+            }
+        }
+
+        module.generation = ++generations_[path];
+        module.epoch = epoch_.load(std::memory_order_relaxed) + 1;
+        modules_.push_back(std::move(module));
+        if (modules_.size() > kMaxModules) {
+            modules_.erase(modules_.begin());
+        }
+        epoch_.store(modules_.back().epoch, std::memory_order_release);
+    }
+
+    // Describe pc as "module#generation`symbol" using the module mapped when the sample was taken
+    std::string symbolize(std::uintptr_t pc, std::uint32_t sampleEpoch) const {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = modules_.rbegin(); it != modules_.rend(); ++it) {
+                if (it->epoch > sampleEpoch || !it->contains(pc)) {
+                    continue;
+                }
+                auto name = std::filesystem::path(it->path).filename().string();
+                auto offset = pc - it->base;
+                auto sym = std::upper_bound(it->symbols.begin(), it->symbols.end(), offset,
+                    [](std::uintptr_t value, const Symbol& s) { return value < s.start; });
+                if (sym != it->symbols.begin() && (--sym, sym->size == 0 || offset < sym->start + sym->size)) {
+                    return fmt::format("{}#{}`{}", name, it->generation, demangle(sym->name));
+                }
+                return fmt::format("{}#{}`+{:#x}", name, it->generation, offset);
+            }
+        }
+
+        // Everything else (server, libc, libstdc++) stays mapped for the life of the process
+        Dl_info info{};
+        if (dladdr(reinterpret_cast<void*>(pc), &info) && info.dli_fname) {
+            auto name = std::filesystem::path(info.dli_fname).filename().string();
+            if (info.dli_sname) {
+                return fmt::format("{}`{}", name, demangle(info.dli_sname));
+            }
+            return fmt::format("{}`+{:#x}", name, pc - reinterpret_cast<std::uintptr_t>(info.dli_fbase));
+        }
+        return fmt::format("{:#x}", pc);
+    }
+
+private:
+    static constexpr std::size_t kMaxModules = 256;
+
+    struct Symbol {
+        std::uintptr_t start;
+        std::uintptr_t size;
+        std::string name;
+    };
+
+    struct Module {
+        std::string path;
+        unsigned generation = 0;
+        std::uint32_t epoch = 0;
+        std::uintptr_t base = 0;
+        unsigned long inode = 0;                                         // File the mapping came from
+        std::vector<std::pair<std::uintptr_t, std::uintptr_t>> ranges;  // Mapped PT_LOAD segments
+        std::vector<Symbol> symbols;                                     // Sorted by start offset
+
+        bool contains(std::uintptr_t pc) const {
+            return std::any_of(ranges.begin(), ranges.end(),
+                [pc](const auto& r) { return pc >= r.first && pc < r.second; });
+        }
+    };
+
+    // Inode of the file mapped at start, which tells a reload at the same address from a repeat dlopen
+    static unsigned long mappedInode(std::uintptr_t start) {
+        std::ifstream maps("/proc/self/maps");
+        std::string line;
+        while (std::getline(maps, line)) {
+            unsigned long from = 0, to = 0, offset = 0, inode = 0;
+            char perms[5], dev[16];
+            if (std::sscanf(line.c_str(), "%lx-%lx %4s %lx %15s %lu", &from, &to, perms, &offset, dev, &inode) == 6 &&
+                from <= start && start < to) {
+                return inode;
+            }
+        }
+        return 0;
+    }
+
+    static std::string demangle(const char* name) {
+        int status = 0;
+        std::unique_ptr<char, decltype(&std::free)> out(abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free);
+        return status == 0 && out ? std::string(out.get()) : std::string(name);
+    }
+
+    static std::string demangle(const std::string& name) { return demangle(name.c_str()); }
+
+    // Number of .dynsym entries, which only the hash tables record
+    static std::size_t symbolCount(const ElfW(Word)* hash, const ElfW(Word)* gnuHash) {
+        if (hash) {
+            return hash[1];
+        }
+        if (!gnuHash) {
+            return 0;
+        }
+        auto nbuckets = gnuHash[0];
+        auto symoffset = gnuHash[1];
+        auto bloomSize = gnuHash[2];
+        auto buckets = reinterpret_cast<const ElfW(Word)*>(
+            reinterpret_cast<const ElfW(Addr)*>(gnuHash + 4) + bloomSize);
+        auto chains = buckets + nbuckets;
+
+        ElfW(Word) last = 0;
+        for (ElfW(Word) i = 0; i < nbuckets; ++i) {
+            last = std::max(last, buckets[i]);
+        }
+        if (last < symoffset) {
+            return symoffset;
+        }
+        while (!(chains[last - symoffset] & 1)) {
+            ++last;
+        }
+        return last + 1;
+    }
+
+    // Copy segment ranges and exported functions out of the mapped image
+    static void snapshot(Module& module) {
+        dl_iterate_phdr([](dl_phdr_info* info, std::size_t, void* data) {
+            auto& module = *static_cast<Module*>(data);
+            if (info->dlpi_addr != module.base) {
+                return 0;
+            }
+
+            const ElfW(Dyn)* dynamic = nullptr;
+            for (int i = 0; i < info->dlpi_phnum; ++i) {
+                const auto& phdr = info->dlpi_phdr[i];
+                if (phdr.p_type == PT_LOAD) {
+                    auto start = info->dlpi_addr + phdr.p_vaddr;
+                    module.ranges.emplace_back(start, start + phdr.p_memsz);
+                } else if (phdr.p_type == PT_DYNAMIC) {
+                    dynamic = reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + phdr.p_vaddr);
+                }
+            }
+            if (!dynamic) {
+                return 1;
+            }
+
+            // glibc relocates these in place; other loaders leave them as offsets
+            auto resolve = [&](ElfW(Addr) ptr) { return ptr < info->dlpi_addr ? ptr + info->dlpi_addr : ptr; };
+            const ElfW(Sym)* symtab = nullptr;
+            const char* strtab = nullptr;
+            const ElfW(Word)* hash = nullptr;
+            const ElfW(Word)* gnuHash = nullptr;
+            for (auto dyn = dynamic; dyn->d_tag != DT_NULL; ++dyn) {
+                switch (dyn->d_tag) {
+                    case DT_SYMTAB:   symtab = reinterpret_cast<const ElfW(Sym)*>(resolve(dyn->d_un.d_ptr)); break;
+                    case DT_STRTAB:   strtab = reinterpret_cast<const char*>(resolve(dyn->d_un.d_ptr)); break;
+                    case DT_HASH:     hash = reinterpret_cast<const ElfW(Word)*>(resolve(dyn->d_un.d_ptr)); break;
+                    case DT_GNU_HASH: gnuHash = reinterpret_cast<const ElfW(Word)*>(resolve(dyn->d_un.d_ptr)); break;
+                }
+            }
+            if (!symtab || !strtab) {
+                return 1;
+            }
+
+            auto count = symbolCount(hash, gnuHash);
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto& sym = symtab[i];
+                if (ELF64_ST_TYPE(sym.st_info) == STT_FUNC && sym.st_shndx != SHN_UNDEF && sym.st_value) {
+                    module.symbols.push_back({sym.st_value, sym.st_size, strtab + sym.st_name});
+                }
+            }
+            std::sort(module.symbols.begin(), module.symbols.end(),
+                [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+            return 1;
+        }, &module);
+    }
+
+    mutable std::mutex mutex_;                  // Guards modules_ and generations_
+    std::vector<Module> modules_;               // Oldest first
+    std::map<std::string, unsigned> generations_;  // Loads seen per library path
+    std::atomic<std::uint32_t> epoch_{0};       // Epoch of the newest module
+};
+
+class SamplingProfiler {
+public:
+    enum class Mode { Cpu, Heap };
+
+    static constexpr unsigned kMaxSeconds = 60;
+    static constexpr unsigned kMaxHz = 1000;
+    static constexpr std::uint64_t kHeapSampleBytes = 512 * 1024;
+
+    static SamplingProfiler& instance() {
+        static SamplingProfiler profiler;
+        return profiler;
+    }
+
+    // Checked by operator new on every allocation
+    static bool heapActive() { return heapActive_.load(std::memory_order_relaxed); }
+
+    // Begin a profile; returns false if one is already running
+    bool start(Mode mode, unsigned seconds, unsigned hz) {
+        bool expected = false;
+        if (!busy_.compare_exchange_strong(expected, true)) {
+            return false;
+        }
+
+        // backtrace() loads libgcc on first use, which is not safe inside a signal handler
+        void* warmup[1];
+        backtrace(warmup, 1);
+
+        mode_ = mode;
+        capacity_ = mode == Mode::Cpu
+            ? std::min<std::size_t>(std::size_t(seconds) * hz * 8, kMaxSamples)
+            : kMaxSamples;
+        samples_.reset(new Sample[capacity_]);
+        next_.store(0);
+        dropped_.store(0);
+
+        if (mode == Mode::Cpu) {
+            installHandler();
+            cpuActive_.store(true);
+            itimerval timer{};
+            auto period = 1000000 / std::max(hz, 1u);
+            timer.it_interval.tv_sec = period / 1000000;
+            timer.it_interval.tv_usec = period % 1000000;
+            timer.it_value = timer.it_interval;
+            setitimer(ITIMER_PROF, &timer, nullptr);
+        } else {
+            heapActive_.store(true);
+        }
+        return true;
+    }
+
+    // End the profile and return it in folded-stack format ("root;...;leaf weight" per line)
+    std::string stop() {
+        if (mode_ == Mode::Cpu) {
+            itimerval off{};
+            setitimer(ITIMER_PROF, &off, nullptr);
+            cpuActive_.store(false);
+        } else {
+            heapActive_.store(false);
+        }
+        // Let samplers that already passed the active check finish writing
+        while (inFlight_.load() > 0) {
+            std::this_thread::yield();
+        }
+
+        auto& registry = ComponentRegistry::instance();
+        std::map<std::string, std::uint64_t> folded;
+        std::map<std::pair<std::uintptr_t, std::uint32_t>, std::string> names;
+        std::size_t count = std::min(next_.load(), capacity_);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& sample = samples_[i];
+            if (!sample.ready.load(std::memory_order_acquire)) {
+                continue;
+            }
+            // CPU samples start at the interrupted PC; heap samples at the code that called operator new
+            int leaf = mode_ == Mode::Cpu ? 0 : allocationCaller(sample);
+            std::string stack;
+            for (int f = sample.depth - 1; f >= leaf; --f) {
+                // Return addresses point past the call; step back into it. Only the CPU leaf is exact.
+                bool exact = mode_ == Mode::Cpu && f == 0;
+                auto pc = reinterpret_cast<std::uintptr_t>(sample.pcs[f]) - (exact ? 0 : 1);
+                auto& name = names[{pc, sample.epoch}];
+                if (name.empty()) {
+                    name = registry.symbolize(pc, sample.epoch);
+                    std::replace(name.begin(), name.end(), ';', ':');
+                }
+                if (!stack.empty()) {
+                    stack += ';';
+                }
+                stack += name;
+            }
+            folded[stack.empty() ? "[unknown]" : stack] += sample.weight;
+        }
+
+        std::string out;
+        for (const auto& [stack, weight] : folded) {
+            out += fmt::format("{} {}\n", stack, weight);
+        }
+        if (auto dropped = dropped_.load()) {
+            out += fmt::format("[dropped] {}\n", dropped);
+        }
+
+        samples_.reset();
+        busy_.store(false);
+        return out;
+    }
+
+    // Called from operator new once heap sampling is active
+    __attribute__((noinline)) void sampleAllocation(std::size_t size) {
+        thread_local std::int64_t untilSample = kHeapSampleBytes;
+        thread_local bool sampling = false;
+        untilSample -= static_cast<std::int64_t>(size);
+        if (untilSample > 0 || sampling) {
+            return;
+        }
+
+        // Each crossing of the sampling interval stands for kHeapSampleBytes allocated
+        std::uint64_t weight = (static_cast<std::uint64_t>(-untilSample) / kHeapSampleBytes + 1) * kHeapSampleBytes;
+        untilSample += static_cast<std::int64_t>(weight);
+        sampling = true;
+        record(heapActive_, weight, nullptr);
+        sampling = false;
+    }
+
+private:
+    static constexpr std::size_t kMaxSamples = 16384;
+    static constexpr int kMaxDepth = 48;
+
+    struct Sample {
+        std::atomic<bool> ready{false};
+        int depth = 0;
+        std::uint32_t epoch = 0;
+        std::uint64_t weight = 0;
+        void* pcs[kMaxDepth];
+    };
+
+    // Keep the handler installed once set; SIGPROF's default action would kill the process
+    void installHandler() {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            struct sigaction action{};
+            action.sa_sigaction = onSignal;
+            action.sa_flags = SA_RESTART | SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGPROF, &action, nullptr);
+        });
+    }
+
+    static void onSignal(int, siginfo_t*, void* context) {
+        int savedErrno = errno;
+        auto& profiler = instance();
+        profiler.record(profiler.cpuActive_, 1, interruptedPc(context));
+        errno = savedErrno;
+    }
+
+    // PC the signal interrupted, taken from the saved register state
+    static void* interruptedPc(void* context) {
+        auto uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+        return reinterpret_cast<void*>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+        return reinterpret_cast<void*>(uc->uc_mcontext.pc);
+#else
+        (void)uc;
+        return nullptr;
+#endif
+    }
+
+    // Index of the first frame above operator new/new[], whatever got inlined into the sampler
+    static int allocationCaller(const Sample& sample) {
+        int leaf = 0;
+        for (int f = 0; f < sample.depth; ++f) {
+            Dl_info info{};
+            bool isNew = dladdr(sample.pcs[f], &info) && info.dli_sname &&
+                         (std::strncmp(info.dli_sname, "_Znw", 4) == 0 || std::strncmp(info.dli_sname, "_Zna", 4) == 0);
+            if (isNew) {
+                leaf = f + 1;
+            } else if (leaf > 0) {
+                break;
+            }
+        }
+        return leaf;
+    }
+
+    // Append one stack to the sample buffer; safe to call from a signal handler.
+    // inFlight_ is raised before checking active so stop() never frees the buffer under us.
+    // With a leaf PC, frames up to and including the signal trampoline are dropped.
+    void record(const std::atomic<bool>& active, std::uint64_t weight, void* leaf) {
+        inFlight_.fetch_add(1);
+        if (!active.load()) {
+            inFlight_.fetch_sub(1);
+            return;
+        }
+        std::size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+        if (i < capacity_) {
+            auto& sample = samples_[i];
+            if (leaf) {
+                // The unwinder reports the interrupted frame right after the trampoline
+                sample.pcs[0] = leaf;
+                int depth = backtrace(sample.pcs + 1, kMaxDepth - 1);
+                int interrupted = 0;
+                while (interrupted < depth && sample.pcs[1 + interrupted] != leaf) {
+                    ++interrupted;
+                }
+                int callers = interrupted < depth ? depth - interrupted - 1 : 0;
+                for (int f = 0; f < callers; ++f) {
+                    sample.pcs[1 + f] = sample.pcs[2 + interrupted + f];
+                }
+                sample.depth = 1 + callers;
+            } else {
+                sample.depth = backtrace(sample.pcs, kMaxDepth);
+            }
+            sample.epoch = ComponentRegistry::instance().epoch();
+            sample.weight = weight;
+            sample.ready.store(true, std::memory_order_release);
+        } else {
+            dropped_.fetch_add(weight, std::memory_order_relaxed);
+        }
+        inFlight_.fetch_sub(1);
+    }
+
+    static inline std::atomic<bool> heapActive_{false};
+
+    Mode mode_ = Mode::Cpu;
+    std::atomic<bool> busy_{false};         // A profile is running
+    std::atomic<bool> cpuActive_{false};    // SIGPROF samples are being recorded
+    std::atomic<int> inFlight_{0};          // Samplers currently writing
+    std::unique_ptr<Sample[]> samples_;     // Preallocated for the whole profile
+    std::size_t capacity_ = 0;
+    std::atomic<std::size_t> next_{0};      // Next free sample slot
+    std::atomic<std::uint64_t> dropped_{0}; // Weight lost to a full buffer
+};
@@ -0,0 +1,624 @@
+#pragma once
+// Prefork mode: a supervisor process owns the listening socket and runs worker processes.
+// Plugins only ever run inside workers, so a crashing endpoint takes down one worker
+// and plugin and component updates roll across workers one at a time. Not available on Windows.
+#include "hot_reload/interfaces.hpp"
+#include <fmt/core.h>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Routes of one plugin generation, laid out flat so it can live in shared memory
+struct RouteManifest {
+    static constexpr std::size_t kMaxRoutes = 256;
+
+    struct Entry {
+        char method[16];
+        char path[240];
+    };
+
+    std::uint64_t generation;
+    std::uint32_t count;
+    Entry routes[kMaxRoutes];
+
+    // Append a route, truncating oversized fields; returns false when full
+    bool add(const RouteInfo& info) {
+        if (count >= kMaxRoutes) {
+            return false;
+        }
+        auto& entry = routes[count++];
+        std::snprintf(entry.method, sizeof(entry.method), "%s", info.method.c_str());
+        std::snprintf(entry.path, sizeof(entry.path), "%s", info.path.c_str());
+        return true;
+    }
+};
+
+// State shared by the supervisor and all workers. Workers map it read-only.
+// Two manifest slots let generation N+1 be built while generation N workers still read theirs.
+struct SharedState {
+    RouteManifest manifests[2];
+
+    const RouteManifest& manifest(std::uint64_t generation) const { return manifests[generation % 2]; }
+    RouteManifest& manifest(std::uint64_t generation) { return manifests[generation % 2]; }
+};
+
+#ifndef _WIN32
+class Supervisor {
+public:
+    // Runs in a forked worker on the snapshot of its generation (plugin is the snapshot's copy of the
+    // plugin); signals readiness by writing to readyFd and returns the exit code
+    using WorkerMain = std::function<int(int listenFd, int readyFd, const SharedState& shared,
+                                         std::uint64_t generation, const std::filesystem::path& plugin)>;
+    // Runs in a short-lived child that loads a plugin snapshot and fills in its routes
+    using ManifestBuilder = std::function<void(RouteManifest& manifest, const std::filesystem::path& plugin)>;
+
+    // componentDirs are the directories, next to the plugin, that components are loaded from
+    Supervisor(unsigned short port, unsigned workers, std::filesystem::path pluginPath,
+               std::vector<std::filesystem::path> componentDirs, WorkerMain workerMain, ManifestBuilder buildManifest)
+        : port_(port),
+          pluginPath_(std::move(pluginPath)),
+          componentDirs_(std::move(componentDirs)),
+          baseDir_(std::filesystem::absolute(pluginPath_).parent_path()),
+          snapshotDir_(baseDir_ / ".generations"),
+          workerMain_(std::move(workerMain)),
+          buildManifest_(std::move(buildManifest)),
+          slots_(std::max(1u, workers)) {}
+
+    ~Supervisor() {
+        if (shared_) {
+            munmap(shared_, sizeof(SharedState));
+        }
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+        }
+    }
+
+    // Supervise workers until SIGINT/SIGTERM
+    int run() {
+        listen();
+        shared_ = static_cast<SharedState*>(mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        if (shared_ == MAP_FAILED) {
+            shared_ = nullptr;
+            throw std::runtime_error(fmt::format("Failed to map shared state: {}", std::strerror(errno)));
+        }
+
+        std::signal(SIGINT, onStopSignal);
+        std::signal(SIGTERM, onStopSignal);
+
+        // Snapshots left behind by a previous supervisor are never reused
+        std::filesystem::remove_all(snapshotDir_);
+        lastStamp_ = componentsStamp(baseDir_);
+        snapshot(generation_);
+        lastHash_ = componentsHash(snapshotPath(generation_).parent_path());
+
+        // The first manifest is bounded by the builder deadline and still honours stop requests
+        startBuild(generation_);
+        while (builder_ > 0 && !stopRequested_) {
+            reapWorkers();
+            pollBuilder();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        for (auto& slot : slots_) {
+            startWorker(slot, generation_);
+        }
+        fmt::print("Supervisor running {} workers on http://localhost:{}\n", slots_.size(), port_);
+
+        // Every step below is non-blocking, so crashes and stop requests are handled mid-rollout
+        auto lastCheck = Clock::now();
+        while (!stopRequested_) {
+            reapWorkers();
+            pollBuilder();
+            pollStarting();
+            pollDraining();
+            restartWorkers();
+            advanceRollout();
+
+            // Poll the plugin and components once a second, like the in-process watcher
+            if (Clock::now() - lastCheck >= std::chrono::seconds(1)) {
+                lastCheck = Clock::now();
+                checkComponents();
+                pruneSnapshots();
+            }
+            if (reloadPending_ && builder_ < 0) {
+                beginRollout();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        fmt::print("Supervisor stopping workers\n");
+        stopAll();
+        std::error_code ec;
+        std::filesystem::remove_all(snapshotDir_, ec);
+        return 0;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot {
+        pid_t pid = -1;                     // Serving worker, or -1 while waiting to restart
+        std::uint64_t generation = 0;       // Generation the serving worker runs
+        pid_t starting = -1;                // New worker that has not reported ready yet
+        std::uint64_t startingGeneration = 0;
+        int readyFd = -1;                   // Read end of the starting worker's ready pipe
+        Clock::time_point readyDeadline;
+        pid_t draining = -1;                // Replaced worker finishing in-flight requests
+        std::uint64_t drainingGeneration = 0;
+        Clock::time_point drainDeadline;
+        unsigned failures = 0;              // Consecutive failed starts or crashes, drives the backoff
+        Clock::time_point started;          // When the serving worker became ready
+        Clock::time_point restartAt;        // Earliest next start after a failure
+    };
+
+    static constexpr auto kReadyTimeout = std::chrono::seconds(10);
+    static constexpr auto kBuildTimeout = std::chrono::seconds(10);
+    static constexpr auto kStopTimeout = std::chrono::seconds(30);
+    static constexpr auto kStableUptime = std::chrono::seconds(30);
+    static constexpr auto kMaxBackoff = std::chrono::milliseconds(10000);
+
+    static void onStopSignal(int) { stopRequested_ = 1; }
+
+    // Bind the listening socket once; workers inherit it across fork
+    void listen() {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd_ < 0) {
+            throw std::runtime_error(fmt::format("Failed to create socket: {}", std::strerror(errno)));
+        }
+        int on = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(listenFd_, SOMAXCONN) < 0) {
+            throw std::runtime_error(fmt::format("Failed to listen on port {}: {}", port_, std::strerror(errno)));
+        }
+    }
+
+    // Load the plugin in a throwaway child so a broken plugin cannot crash the supervisor.
+    // The child is reaped by reapWorkers() and killed by pollBuilder() if it hangs.
+    void startBuild(std::uint64_t generation) {
+        auto& manifest = shared_->manifest(generation);
+        manifest.generation = generation;
+        manifest.count = 0;
+
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            fmt::print("Supervisor: fork failed: {}\n", std::strerror(errno));
+            finishBuild(generation, false);
+            return;
+        }
+        if (pid == 0) {
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            int code = 0;
+            try {
+                buildManifest_(manifest, snapshotPath(generation));
+            } catch (const std::exception& e) {
+                fmt::print("Manifest builder error: {}\n", e.what());
+                code = 1;
+            }
+            std::fflush(stdout);
+            _exit(code);
+        }
+
+        builder_ = pid;
+        builderGeneration_ = generation;
+        builderDeadline_ = Clock::now() + kBuildTimeout;
+    }
+
+    // Kill a builder stuck loading the plugin; reapWorkers() then records the failure
+    void pollBuilder() {
+        if (builder_ > 0 && Clock::now() >= builderDeadline_) {
+            fmt::print("Supervisor: manifest builder {} timed out, killing\n", builder_);
+            kill(builder_, SIGKILL);
+            builderDeadline_ = Clock::time_point::max();
+        }
+    }
+
+    // Adopt a successfully built generation for new workers, or keep the current one
+    void finishBuild(std::uint64_t generation, bool ok) {
+        builder_ = -1;
+        if (!ok) {
+            shared_->manifest(generation).count = 0;
+        }
+        if (generation == generation_) {
+            // Initial build: workers start either way
+            if (ok) {
+                fmt::print("Supervisor: generation {} has {} routes\n", generation, shared_->manifest(generation).count);
+            } else {
+                fmt::print("Supervisor: initial manifest failed, starting workers anyway\n");
+            }
+            return;
+        }
+        if (!ok) {
+            fmt::print("Supervisor: plugin failed to load, keeping generation {}\n", generation_);
+            return;
+        }
+
+        fmt::print("Supervisor: generation {} has {} routes\n", generation, shared_->manifest(generation).count);
+        // Any worker started from now on loads this generation's snapshot
+        generation_ = generation;
+        for (auto& slot : slots_) {
+            slot.restartAt = Clock::now();
+            slot.failures = 0;
+        }
+    }
+
+    // Fork a worker for slot; readiness is picked up later by pollStarting()
+    void startWorker(Slot& slot, std::uint64_t generation) {
+        int ready[2];
+        if (pipe(ready) < 0) {
+            fmt::print("Supervisor: pipe failed: {}\n", std::strerror(errno));
+            startFailed(slot);
+            return;
+        }
+
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            fmt::print("Supervisor: fork failed: {}\n", std::strerror(errno));
+            close(ready[0]);
+            close(ready[1]);
+            startFailed(slot);
+            return;
+        }
+        if (pid == 0) {
+            close(ready[0]);
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            mprotect(shared_, sizeof(SharedState), PROT_READ);
+
+            int code = 1;
+            try {
+                code = workerMain_(listenFd_, ready[1], *shared_, generation, snapshotPath(generation));
+            } catch (const std::exception& e) {
+                fmt::print("Worker error: {}\n", e.what());
+            }
+            std::fflush(stdout);
+            _exit(code);
+        }
+
+        close(ready[1]);
+        slot.starting = pid;
+        slot.startingGeneration = generation;
+        slot.readyFd = ready[0];
+        slot.readyDeadline = Clock::now() + kReadyTimeout;
+    }
+
+    // Promote starting workers that reported ready; the worker they replace starts draining
+    void pollStarting() {
+        for (auto& slot : slots_) {
+            if (slot.starting < 0) {
+                continue;
+            }
+            pollfd pfd{slot.readyFd, POLLIN, 0};
+            char byte = 0;
+            bool signalled = poll(&pfd, 1, 0) == 1;
+            if (signalled && read(slot.readyFd, &byte, 1) == 1) {
+                fmt::print("Supervisor: worker {} ready (generation {})\n", slot.starting, slot.startingGeneration);
+                if (slot.pid > 0) {
+                    kill(slot.pid, SIGTERM);
+                    slot.draining = slot.pid;
+                    slot.drainingGeneration = slot.generation;
+                    slot.drainDeadline = Clock::now() + kStopTimeout;
+                }
+                slot.pid = slot.starting;
+                slot.generation = slot.startingGeneration;
+                slot.started = Clock::now();
+                slot.failures = 0;
+                clearStarting(slot);
+            } else if (signalled || Clock::now() >= slot.readyDeadline) {
+                // Pipe closed without a byte (worker died) or it never got ready
+                fmt::print("Supervisor: worker {} (generation {}) failed to start\n",
+                           slot.starting, slot.startingGeneration);
+                kill(slot.starting, SIGKILL);
+                waitpid(slot.starting, nullptr, 0);
+                clearStarting(slot);
+                startFailed(slot);
+            }
+        }
+    }
+
+    // Escalate to SIGKILL for replaced workers that take too long to drain
+    void pollDraining() {
+        for (auto& slot : slots_) {
+            if (slot.draining > 0 && Clock::now() >= slot.drainDeadline) {
+                fmt::print("Supervisor: worker {} did not drain, killing\n", slot.draining);
+                kill(slot.draining, SIGKILL);
+                slot.drainDeadline = Clock::time_point::max();
+            }
+        }
+    }
+
+    void clearStarting(Slot& slot) {
+        close(slot.readyFd);
+        slot.readyFd = -1;
+        slot.starting = -1;
+    }
+
+    // Collect exited workers and schedule restarts of crashed ones
+    void reapWorkers() {
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            if (pid == builder_) {
+                finishBuild(builderGeneration_, WIFEXITED(status) && WEXITSTATUS(status) == 0);
+                continue;
+            }
+            for (auto& slot : slots_) {
+                if (slot.draining == pid) {
+                    slot.draining = -1;
+                } else if (slot.starting == pid) {
+                    // Died before reporting ready; pollStarting() would otherwise wait for the deadline
+                    fmt::print("Supervisor: worker {} (generation {}) failed to start\n", pid, slot.startingGeneration);
+                    clearStarting(slot);
+                    startFailed(slot);
+                } else if (slot.pid == pid) {
+                    if (WIFSIGNALED(status)) {
+                        fmt::print("Supervisor: worker {} killed by signal {}\n", pid, WTERMSIG(status));
+                    } else {
+                        fmt::print("Supervisor: worker {} exited with {}\n", pid, WEXITSTATUS(status));
+                    }
+                    slot.pid = -1;
+                    if (Clock::now() - slot.started >= kStableUptime) {
+                        slot.failures = 0;
+                    }
+                    startFailed(slot);
+                }
+            }
+        }
+    }
+
+    // Back off exponentially before the slot's next start attempt
+    void startFailed(Slot& slot) {
+        ++slot.failures;
+        auto backoff = std::min<std::chrono::milliseconds>(
+            std::chrono::milliseconds(100) * (1u << std::min(slot.failures - 1, 10u)), kMaxBackoff);
+        slot.restartAt = Clock::now() + backoff;
+        fmt::print("Supervisor: next start in {} ms\n", backoff.count());
+    }
+
+    void restartWorkers() {
+        auto now = Clock::now();
+        for (auto& slot : slots_) {
+            if (slot.pid < 0 && slot.starting < 0 && now >= slot.restartAt) {
+                startWorker(slot, generation_);
+            }
+        }
+    }
+
+    // Replace one outdated worker at a time; the next only starts once the previous has drained
+    void advanceRollout() {
+        auto busy = std::any_of(slots_.begin(), slots_.end(), [](const Slot& s) {
+            return (s.pid > 0 && s.starting > 0) || s.draining > 0;
+        });
+        if (busy) {
+            return;
+        }
+
+        auto now = Clock::now();
+        for (auto& slot : slots_) {
+            if (slot.pid > 0 && slot.starting < 0 && slot.generation != generation_ && now >= slot.restartAt) {
+                startWorker(slot, generation_);
+                return;
+            }
+        }
+    }
+
+    // True while any live, starting or draining worker reads the manifest slot of generation
+    bool manifestInUse(std::uint64_t generation) const {
+        auto parity = generation % 2;
+        return std::any_of(slots_.begin(), slots_.end(), [parity](const Slot& s) {
+            return (s.pid > 0 && s.generation % 2 == parity) ||
+                   (s.starting > 0 && s.startingGeneration % 2 == parity) ||
+                   (s.draining > 0 && s.drainingGeneration % 2 == parity);
+        });
+    }
+
+    // Plugin plus every file in the component directories under root, relative to root
+    std::vector<std::filesystem::path> componentFiles(const std::filesystem::path& root) const {
+        std::vector<std::filesystem::path> files;
+        for (const auto& dir : componentDirs_) {
+            if (!std::filesystem::is_directory(root / dir)) {
+                continue;
+            }
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(root / dir)) {
+                if (entry.is_regular_file()) {
+                    files.push_back(entry.path().lexically_relative(root));
+                }
+            }
+        }
+        std::sort(files.begin(), files.end());
+        files.insert(files.begin(), pluginPath_.filename());
+        return files;
+    }
+
+    // Cheap fingerprint of names and mtimes, polled every second
+    std::size_t componentsStamp(const std::filesystem::path& root) const {
+        std::string stamp;
+        for (const auto& file : componentFiles(root)) {
+            stamp += fmt::format("{}:{}\n", file.string(),
+                                 std::filesystem::last_write_time(root / file).time_since_epoch().count());
+        }
+        return std::hash<std::string>{}(stamp);
+    }
+
+    // Hash of names and bytes, the same content check the in-process watcher uses
+    std::size_t componentsHash(const std::filesystem::path& root) const {
+        std::string content;
+        for (const auto& file : componentFiles(root)) {
+            std::ifstream in(root / file, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error(fmt::format("Failed to read {}", (root / file).string()));
+            }
+            content += file.string();
+            content += '\0';
+            content.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        return std::hash<std::string>{}(content);
+    }
+
+    // Private copy of the plugin and components that every process of a generation runs from.
+    // Restarts after a crash get the generation's bytes even if files on disk changed or broke since.
+    std::filesystem::path snapshotPath(std::uint64_t generation) const {
+        return snapshotDir_ / std::to_string(generation) / pluginPath_.filename();
+    }
+
+    void snapshot(std::uint64_t generation) {
+        auto dir = snapshotPath(generation).parent_path();
+        std::filesystem::remove_all(dir);
+        for (const auto& file : componentFiles(baseDir_)) {
+            std::filesystem::create_directories((dir / file).parent_path());
+            std::filesystem::copy_file(baseDir_ / file, dir / file);
+        }
+    }
+
+    // Delete snapshots of generations no process runs or will start on
+    void pruneSnapshots() {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(snapshotDir_, ec)) {
+            std::uint64_t generation = 0;
+            auto name = entry.path().filename().string();
+            auto [end, parse] = std::from_chars(name.data(), name.data() + name.size(), generation);
+            if (parse != std::errc() || end != name.data() + name.size() ||
+                generation == generation_ || (builder_ > 0 && generation == builderGeneration_)) {
+                continue;
+            }
+            auto inUse = std::any_of(slots_.begin(), slots_.end(), [generation](const Slot& s) {
+                return (s.pid > 0 && s.generation == generation) ||
+                       (s.starting > 0 && s.startingGeneration == generation) ||
+                       (s.draining > 0 && s.drainingGeneration == generation);
+            });
+            if (!inUse) {
+                std::filesystem::remove_all(entry.path(), ec);
+            }
+        }
+    }
+
+    // Flag a reload once the plugin or a component has changed, settled for a second, and the bytes differ
+    void checkComponents() {
+        try {
+            auto currentStamp = componentsStamp(baseDir_);
+            if (currentStamp != lastStamp_) {
+                lastStamp_ = currentStamp;
+                changedAt_ = Clock::now();
+            } else if (changedAt_ && Clock::now() - *changedAt_ >= std::chrono::seconds(1)) {
+                changedAt_.reset();
+                // Skip the reload when files were only touched, not rewritten
+                auto currentHash = componentsHash(baseDir_);
+                if (currentHash != lastHash_) {
+                    lastHash_ = currentHash;
+                    reloadPending_ = true;
+                }
+            }
+        } catch (const std::exception& e) {
+            fmt::print("Supervisor watcher error: {}\n", e.what());
+        }
+    }
+
+    // Start building a new generation, but only into a manifest slot no running worker reads.
+    // Normally that is generation_ + 1. If a stuck rollout has no worker on generation_ yet,
+    // generation_ + 2 retargets it. Otherwise wait for the current rollout to finish.
+    void beginRollout() {
+        auto next = generation_ + 1;
+        if (manifestInUse(next)) {
+            next = generation_ + 2;
+            if (manifestInUse(next)) {
+                return;
+            }
+        }
+
+        reloadPending_ = false;
+        fmt::print("Supervisor: components changed, rolling to generation {}\n", next);
+        try {
+            snapshot(next);
+        } catch (const std::exception& e) {
+            fmt::print("Supervisor: failed to snapshot components: {}, keeping generation {}\n", e.what(), generation_);
+            return;
+        }
+        startBuild(next);
+    }
+
+    // SIGTERM every worker, then wait for all of them together
+    void stopAll() {
+        std::vector<pid_t> pids;
+        if (builder_ > 0) {
+            kill(builder_, SIGKILL);
+            pids.push_back(builder_);
+        }
+        for (auto& slot : slots_) {
+            for (pid_t pid : {slot.pid, slot.starting, slot.draining}) {
+                if (pid > 0) {
+                    kill(pid, SIGTERM);
+                    pids.push_back(pid);
+                }
+            }
+            if (slot.starting > 0) {
+                close(slot.readyFd);
+            }
+        }
+
+        auto deadline = Clock::now() + kStopTimeout;
+        while (!pids.empty() && Clock::now() < deadline) {
+            pids.erase(std::remove_if(pids.begin(), pids.end(),
+                [](pid_t pid) { return waitpid(pid, nullptr, WNOHANG) == pid; }), pids.end());
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        for (pid_t pid : pids) {
+            fmt::print("Supervisor: worker {} did not drain, killing\n", pid);
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    unsigned short port_;                   // Port of the shared listening socket
+    std::filesystem::path pluginPath_;      // Plugin watched for rolling reloads
+    std::vector<std::filesystem::path> componentDirs_;  // Component directories watched with it
+    std::filesystem::path baseDir_;         // Directory holding the plugin and component directories
+    std::filesystem::path snapshotDir_;     // Per-generation copies of the plugin and components
+    WorkerMain workerMain_;                 // Body of each worker process
+    ManifestBuilder buildManifest_;         // Fills the route manifest for a generation
+    std::vector<Slot> slots_;               // One slot per worker
+    int listenFd_ = -1;                     // Listening socket owned by the supervisor
+    SharedState* shared_ = nullptr;         // Shared memory mapped before forking
+    std::uint64_t generation_ = 0;          // Plugin generation new workers start on
+    pid_t builder_ = -1;                    // Child building a manifest, or -1
+    std::uint64_t builderGeneration_ = 0;   // Generation the builder fills in
+    Clock::time_point builderDeadline_;     // When a hung builder gets killed
+    std::size_t lastStamp_ = 0;             // Names and mtimes of the files last seen
+    std::optional<Clock::time_point> changedAt_;    // When the mtime last changed, until it settles
+    std::size_t lastHash_ = 0;              // Hash of the plugin and component bytes last rolled out
+    bool reloadPending_ = false;            // Files changed; rollout starts once a manifest slot is free
+
+    static inline volatile std::sig_atomic_t stopRequested_ = 0;
+};
+#endif
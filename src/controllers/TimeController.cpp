@@ -6,7 +6,11 @@ class TimeController : public IController {
 public:
     std::shared_ptr<IRouter> getRouter() override {
         if (!router_) {
-            void* handle = dlopen("routers/libApiRouter.dylib", RTLD_NOW);
+#ifdef __APPLE__
+            void* handle = loadComponent("routers/libApiRouter.dylib", RTLD_NOW);
+#else
+            void* handle = loadComponent("routers/libApiRouter.so", RTLD_NOW);
+#endif
             if (handle) {
                 auto createFunc = (IRouter*(*)())dlsym(handle, "createRouter");
                 if (createFunc) {
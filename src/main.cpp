@@ -5,10 +5,18 @@
 #include <boost/asio.hpp>
 #include <fmt/core.h>
 #include "hot_reload/interfaces.hpp"
+#include "Supervisor.hpp"
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <chrono>
 #include <thread>
 #include <memory>
+#include <functional>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <new>
 
 
 // Platform-specific dynamic library loading macros and types
@@ -22,18 +30,81 @@
 #else
     // Unix/Linux/MacOS dynamic library functions
     #include <dlfcn.h>
-    #define LOAD_LIBRARY(path) dlopen(path, RTLD_NOW)  // Load shared library
+    #define LOAD_LIBRARY(path) loadComponent(path, RTLD_NOW)  // Load shared library
     #define GET_PROC_ADDRESS dlsym                      // Get function from shared library
     #define CLOSE_LIBRARY dlclose                       // Unload shared library
     typedef void* LibraryHandle;                        // Unix shared library handle type
 #endif
 
+// I/O backend selected at build time (-DHOT_RELOAD_IO_URING=ON)
+#if defined(BOOST_ASIO_HAS_IO_URING)
+    #include <boost/version.hpp>
+    #if BOOST_VERSION < 107800
+        #error "io_uring backend needs Boost 1.78 or newer"
+    #endif
+    #include <unistd.h>
+    constexpr const char* kIoBackend = "io_uring";
+#else
+    constexpr const char* kIoBackend = "epoll";
+#endif
+
+// Sampling profiler for /debug/profile
+#if defined(__linux__)
+    #include "Profiler.hpp"
+
+// Called by loadComponent() in every component so the profiler can symbolize reloaded code
+extern "C" EXPORT void hotReloadComponentLoaded(void* handle, const char* path) {
+    ComponentRegistry::instance().add(handle, path);
+}
+
+// Allocation hook for heap profiles; a single relaxed load while heap sampling is off
+void* operator new(std::size_t size) {
+    if (SamplingProfiler::heapActive()) {
+        SamplingProfiler::instance().sampleAllocation(size);
+    }
+    while (true) {
+        if (void* p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+#endif
+
+#ifndef _WIN32
+// Queried by componentHotSwapEnabled() in routers; prefork workers turn it off
+static bool componentHotSwap = true;
+
+extern "C" EXPORT bool hotReloadComponentHotSwap() {
+    return componentHotSwap;
+}
+#endif
+
 // Namespace aliases for cleaner code
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+#if defined(BOOST_ASIO_HAS_IO_URING)
+// True when Asio can set up its ring. Creating a socket builds the same full-size ring the
+// server will use, which a small probe ring can't stand in for under a low RLIMIT_MEMLOCK.
+bool ioUringAvailable() {
+    try {
+        net::io_context ioc{1};
+        tcp::socket socket(ioc);
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print("io_uring unavailable: {}\n", e.what());
+        return false;
+    }
+}
+#endif
+
 // Handles loading, unloading and managing plugin libraries
 class PluginLoader {
 public:
@@ -85,6 +156,77 @@ private:
     Plugin* plugin_;         // Current plugin instance
 };
 
+// Determine plugin path based on platform
+std::filesystem::path defaultPluginPath() {
+    #ifdef _WIN32
+        return "plugin.dll";
+    #elif __APPLE__
+        return "libmanager.dylib";
+    #else
+        return "libmanager.so";
+    #endif
+}
+
+// Reads whole files on the io_context, through io_uring when available
+class FileReader {
+public:
+    using Handler = std::function<void(beast::error_code, std::string)>;
+
+    explicit FileReader(net::io_context& ioc) : ioc_(ioc) {}
+
+    // Read the file at path and invoke handler on the io_context
+    void asyncRead(const std::filesystem::path& path, Handler handler) {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+        beast::error_code ec;
+        auto file = std::make_shared<net::random_access_file>(ioc_);
+        file->open(path.string(), net::random_access_file::read_only, ec);
+        std::uint64_t size = ec ? 0 : file->size(ec);
+        if (ec) {
+            net::post(ioc_, [handler = std::move(handler), ec]() { handler(ec, {}); });
+            return;
+        }
+
+        // Single io_uring read for the whole file
+        auto data = std::make_shared<std::string>(size, '\0');
+        net::async_read_at(*file, 0, net::buffer(*data),
+            [file, data, handler = std::move(handler)](beast::error_code ec, std::size_t n) {
+                data->resize(n);
+                handler(ec == net::error::eof ? beast::error_code{} : ec, std::move(*data));
+            });
+#else
+        // epoll has no file readiness, so read synchronously and complete on the io_context
+        std::ifstream in(path, std::ios::binary);
+        beast::error_code ec;
+        std::string data;
+        if (in) {
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        } else {
+            ec = beast::errc::make_error_code(beast::errc::no_such_file_or_directory);
+        }
+        net::post(ioc_, [handler = std::move(handler), ec, data = std::move(data)]() mutable {
+            handler(ec, std::move(data));
+        });
+#endif
+    }
+
+    // Blocking read for threads other than the one running the io_context
+    std::string read(const std::filesystem::path& path) {
+        auto result = std::make_shared<std::promise<std::string>>();
+        auto future = result->get_future();
+        asyncRead(path, [result](beast::error_code ec, std::string data) {
+            if (ec) {
+                result->set_exception(std::make_exception_ptr(beast::system_error(ec)));
+            } else {
+                result->set_value(std::move(data));
+            }
+        });
+        return future.get();
+    }
+
+private:
+    net::io_context& ioc_;
+};
+
 // Main HTTP server class
 class HttpServer {
     // Forward declare Session class
@@ -93,35 +235,46 @@ class HttpServer {
 public:
     // Initialize server with io_context and port
     HttpServer(net::io_context& ioc, unsigned short port) 
-        : acceptor_(ioc, {net::ip::make_address("127.0.0.1"), port}),
-          loader_() {
-        
-        // Determine plugin path based on platform
-        std::filesystem::path pluginPath;
-        #ifdef _WIN32
-            pluginPath = "plugin.dll";
-        #elif __APPLE__
-            pluginPath = "libmanager.dylib";
-        #else
-            pluginPath = "libplugin.so";
-        #endif
-
-        // Load initial plugin
-        if (!loader_.loadPlugin(pluginPath.string())) {
-            throw std::runtime_error(fmt::format("Failed to load initial plugin from {}", pluginPath.string()));
-        }
-
+        : HttpServer(ioc, tcp::acceptor(ioc, {net::ip::make_address("127.0.0.1"), port}), defaultPluginPath(),
+                     std::filesystem::current_path() / "static", nullptr) {
         // Start watching for plugin changes
-        startPluginWatcher(pluginPath);
+        startPluginWatcher(defaultPluginPath());
     }
 
+#ifndef _WIN32
+    // Initialize a prefork worker on the supervisor's listening socket; the supervisor handles reloads
+    HttpServer(net::io_context& ioc, int listenFd, const std::filesystem::path& pluginPath,
+               const std::filesystem::path& staticDir, const RouteManifest* manifest)
+        : HttpServer(ioc, tcp::acceptor(ioc, tcp::v4(), listenFd), pluginPath, staticDir, manifest) {}
+#endif
+
     // Start accepting connections
     void run() {
         accept();
-        fmt::print("Server running on http://localhost:63090\n");
+        fmt::print("Server running on http://localhost:63090 ({} backend)\n", kIoBackend);
+    }
+
+    // Stop accepting; in-flight sessions finish and the io_context runs out of work
+    void stop() {
+        beast::error_code ec;
+        acceptor_.close(ec);
     }
 
 private:
+    HttpServer(net::io_context& ioc, tcp::acceptor acceptor, const std::filesystem::path& pluginPath,
+               std::filesystem::path staticDir, const RouteManifest* manifest)
+        : acceptor_(std::move(acceptor)),
+          loader_(),
+          reader_(ioc),
+          staticDir_(std::move(staticDir)),
+          manifest_(manifest) {
+        
+        // Load initial plugin
+        if (!loader_.loadPlugin(pluginPath.string())) {
+            throw std::runtime_error(fmt::format("Failed to load initial plugin from {}", pluginPath.string()));
+        }
+    }
+
     // Accept incoming connections
     void accept() {
         acceptor_.async_accept(
@@ -129,7 +282,9 @@ private:
                 if (!ec) {
                     std::make_shared<Session>(*this, std::move(socket))->run();
                 }
-                accept();
+                if (acceptor_.is_open()) {
+                    accept();
+                }
             });
     }
 
@@ -137,16 +292,31 @@ private:
     void startPluginWatcher(const std::filesystem::path& pluginPath) {
         watcher_ = std::thread([this, pluginPath]() {
             auto lastWrite = std::filesystem::last_write_time(pluginPath);
+            std::size_t lastHash = 0;
+            try {
+                lastHash = std::hash<std::string>{}(reader_.read(pluginPath));
+            } catch (const std::exception& e) {
+                fmt::print("Watcher error: {}\n", e.what());
+            }
             while (true) {
                 std::this_thread::sleep_for(std::chrono::seconds(1));
                 try {
                     // Check if plugin file has been modified
                     auto currentWrite = std::filesystem::last_write_time(pluginPath);
                     if (currentWrite != lastWrite) {
-                        fmt::print("Plugin changed, reloading...\n");
                         std::this_thread::sleep_for(std::chrono::seconds(1));
+
+                        // Skip the reload when the file was only touched, not rewritten
+                        auto currentHash = std::hash<std::string>{}(reader_.read(pluginPath));
+                        if (currentHash == lastHash) {
+                            lastWrite = currentWrite;
+                            continue;
+                        }
+
+                        fmt::print("Plugin changed, reloading...\n");
                         if (loader_.loadPlugin(pluginPath.string())) {
                             lastWrite = currentWrite;
+                            lastHash = currentHash;
                         }
                     }
                 } catch (const std::exception& e) {
@@ -183,6 +353,22 @@ private:
 
         // Process HTTP request and route to plugin
         void handle_request() {
+            std::string_view target(req_.target().data(), req_.target().size());
+            if (req_.method() == http::verb::get && target.rfind("/static/", 0) == 0) {
+                serve_static(target.substr(8, target.find('?') - 8));
+                return;
+            }
+            if (server_.manifest_ && req_.method() == http::verb::get && target == "/routes") {
+                serve_routes(*server_.manifest_);
+                return;
+            }
+#if defined(__linux__)
+            if (req_.method() == http::verb::get && target.substr(0, target.find('?')) == "/debug/profile") {
+                serve_profile(target);
+                return;
+            }
+#endif
+
             http::response<http::string_body> res{http::status::ok, req_.version()};
             res.set(http::field::server, "Beast");
             res.set(http::field::content_type, "text/plain");
@@ -209,6 +395,97 @@ private:
             do_write(std::move(res));
         }
 
+        // Serve a file from the static directory next to the server
+        void serve_static(std::string_view relative) {
+            std::filesystem::path file = std::filesystem::path(std::string(relative)).lexically_normal();
+            if (relative.empty() || file.is_absolute() || *file.begin() == "..") {
+                do_write(make_response(http::status::bad_request, "Invalid static path", "text/plain"));
+                return;
+            }
+
+            server_.reader_.asyncRead(server_.staticDir_ / file,
+                [self = shared_from_this(), file](beast::error_code ec, std::string data) {
+                    if (ec) {
+                        self->do_write(self->make_response(http::status::not_found, "404 - File not found", "text/plain"));
+                    } else {
+                        self->do_write(self->make_response(http::status::ok, std::move(data), mime_type(file)));
+                    }
+                });
+        }
+
+        // List the routes of this worker's plugin generation from shared memory
+        void serve_routes(const RouteManifest& manifest) {
+            std::string body = fmt::format("generation {}\n", manifest.generation);
+            for (std::uint32_t i = 0; i < manifest.count; ++i) {
+                body += fmt::format("{} {}\n", manifest.routes[i].method, manifest.routes[i].path);
+            }
+            do_write(make_response(http::status::ok, std::move(body), "text/plain"));
+        }
+
+#if defined(__linux__)
+        // Sample this process for ?seconds=N (cpu, or mode=heap) and reply with folded stacks
+        void serve_profile(std::string_view target) {
+            auto mode = query_param(target, "mode") == "heap"
+                ? SamplingProfiler::Mode::Heap : SamplingProfiler::Mode::Cpu;
+            auto seconds = std::clamp(parse_uint(query_param(target, "seconds"), 10), 1u, SamplingProfiler::kMaxSeconds);
+            auto hz = std::clamp(parse_uint(query_param(target, "hz"), 99), 1u, SamplingProfiler::kMaxHz);
+
+            if (!SamplingProfiler::instance().start(mode, seconds, hz)) {
+                do_write(make_response(http::status::conflict, "Profile already running", "text/plain"));
+                return;
+            }
+            auto timer = std::make_shared<net::steady_timer>(socket_.get_executor(), std::chrono::seconds(seconds));
+            timer->async_wait([self = shared_from_this(), timer](beast::error_code) {
+                self->do_write(self->make_response(http::status::ok, SamplingProfiler::instance().stop(), "text/plain"));
+            });
+        }
+#endif
+
+        // Value of key in the target's query string, or empty
+        static std::string_view query_param(std::string_view target, std::string_view key) {
+            auto query = target.find('?');
+            while (query != std::string_view::npos) {
+                auto start = query + 1;
+                auto end = target.find('&', start);
+                auto pair = target.substr(start, end == std::string_view::npos ? end : end - start);
+                if (pair.size() > key.size() && pair.substr(0, key.size()) == key && pair[key.size()] == '=') {
+                    return pair.substr(key.size() + 1);
+                }
+                query = end;
+            }
+            return {};
+        }
+
+        static unsigned parse_uint(std::string_view text, unsigned fallback) {
+            unsigned value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return ec == std::errc() && end == text.data() + text.size() && !text.empty() ? value : fallback;
+        }
+
+        // Build a complete response for the current request
+        http::response<http::string_body> make_response(http::status status, std::string body, std::string_view type) {
+            http::response<http::string_body> res{status, req_.version()};
+            res.set(http::field::server, "Beast");
+            res.set(http::field::content_type, beast::string_view(type.data(), type.size()));
+            res.body() = std::move(body);
+            res.prepare_payload();
+            return res;
+        }
+
+        // Content type for a static file based on its extension
+        static std::string_view mime_type(const std::filesystem::path& file) {
+            auto ext = file.extension().string();
+            if (ext == ".html" || ext == ".htm") return "text/html";
+            if (ext == ".css")  return "text/css";
+            if (ext == ".js")   return "application/javascript";
+            if (ext == ".json") return "application/json";
+            if (ext == ".txt")  return "text/plain";
+            if (ext == ".png")  return "image/png";
+            if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+            if (ext == ".svg")  return "image/svg+xml";
+            return "application/octet-stream";
+        }
+
         // Asynchronously write HTTP response
         void do_write(http::response<http::string_body>&& res) {
             auto sp = std::make_shared<http::response<http::string_body>>(std::move(res));
@@ -226,12 +503,104 @@ private:
 
     tcp::acceptor acceptor_;     // Accepts incoming connections
     PluginLoader loader_;        // Manages plugin loading/unloading
+    FileReader reader_;          // Reads static files and plugin files
+    std::filesystem::path staticDir_;  // Directory served under /static/
+    const RouteManifest* manifest_;  // Shared route manifest in prefork mode, else null
     std::thread watcher_;        // Thread for watching plugin changes
 };
 
+#ifndef _WIN32
+// Prefork worker: serve on the inherited socket until the supervisor sends SIGTERM
+int runWorker(int listenFd, int readyFd, const SharedState& shared, std::uint64_t generation,
+              const std::filesystem::path& plugin) {
+    // Components resolve endpoints/, routers/ and controllers/ against the working directory,
+    // so run from the generation's snapshot. The supervisor rolls out component changes.
+    auto staticDir = std::filesystem::current_path() / "static";
+    std::filesystem::current_path(plugin.parent_path());
+    componentHotSwap = false;
+
+    net::io_context ioc{1};
+    HttpServer server{ioc, listenFd, plugin, staticDir, &shared.manifest(generation)};
+    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&server](beast::error_code, int) { server.stop(); });
+    server.run();
+
+    // Tell the supervisor the plugin loaded and we are accepting
+    char ready = 1;
+    write(readyFd, &ready, 1);
+    close(readyFd);
+
+    ioc.run();
+    return 0;
+}
+
+// Load the plugin and record every route it exposes
+void buildRouteManifest(RouteManifest& manifest, const std::filesystem::path& plugin) {
+    std::filesystem::current_path(plugin.parent_path());
+    componentHotSwap = false;
+    PluginLoader loader;
+    if (!loader.loadPlugin(plugin.string())) {
+        throw std::runtime_error(fmt::format("Failed to load plugin from {}", plugin.string()));
+    }
+    for (const auto& controller : loader.getPlugin()->getControllers()) {
+        if (auto router = controller->getRouter()) {
+            for (const auto& route : router->getRoutes()) {
+                if (!manifest.add(route)) {
+                    fmt::print("Route manifest full, dropping {} {}\n", route.method, route.path);
+                }
+            }
+        }
+    }
+}
+#endif
+
 // Entry point
-int main() {
+int main(int argc, char* argv[]) {
+#if defined(BOOST_ASIO_HAS_IO_URING)
+    // Kernels without io_uring (or with it disabled) get the epoll build instead
+    if (!ioUringAvailable()) {
+        std::error_code ec;
+        auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+        if (ec) {
+            fmt::print("Error: cannot locate server_epoll: {}\n", ec.message());
+            return 1;
+        }
+        auto fallback = self.parent_path() / "server_epoll";
+        fmt::print("Falling back to {}\n", fallback.string());
+        execv(fallback.c_str(), argv);
+        fmt::print("Error: failed to start {}: {}\n", fallback.string(), std::strerror(errno));
+        return 1;
+    }
+#endif
+
+    // --workers N runs N prefork workers under a supervisor instead of a single process
     try {
+        unsigned workers = 0;
+        for (int i = 1; i < argc; ++i) {
+            if (std::string_view(argv[i]) == "--workers") {
+#ifdef _WIN32
+                // Prefork relies on fork() and a shared listening socket
+                throw std::runtime_error("--workers is not supported on Windows");
+#else
+                // Cap well above core count, but below a fork bomb
+                unsigned maxWorkers = std::max(1u, std::thread::hardware_concurrency()) * 4;
+                std::string_view value = i + 1 < argc ? argv[++i] : "";
+                auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), workers);
+                if (ec != std::errc() || end != value.data() + value.size() || workers < 1 || workers > maxWorkers) {
+                    throw std::runtime_error(fmt::format("--workers must be between 1 and {}, got '{}'", maxWorkers, value));
+                }
+#endif
+            }
+        }
+
+#ifndef _WIN32
+        if (workers > 0) {
+            Supervisor supervisor{63090, workers, defaultPluginPath(), {"endpoints", "routers", "controllers"},
+                                  runWorker, buildRouteManifest};
+            return supervisor.run();
+        }
+#endif
+
         net::io_context ioc{1};              // IO context with 1 thread
         HttpServer server{ioc, 63090};       // Create server on port 63090
         server.run();                        // Start accepting connections
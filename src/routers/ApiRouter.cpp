@@ -17,7 +17,9 @@ public:
     }
 
     std::shared_ptr<IEndpoint> getEndpoint(const std::string& path) override {
-        checkForUpdates();  // Check for updates before returning endpoint
+        if (componentHotSwapEnabled()) {
+            checkForUpdates();  // Check for updates before returning endpoint
+        }
         auto it = endpoints_.find(path);
         return it != endpoints_.end() ? it->second : nullptr;
     }
@@ -30,7 +32,7 @@ private:
                 entry.path().extension() == ".dylib" ||
                 entry.path().extension() == ".dll") {
                 
-                void* handle = dlopen(entry.path().c_str(), RTLD_NOW);
+                void* handle = loadComponent(entry.path().c_str(), RTLD_NOW);
                 if (handle) {
                     auto createFunc = (IEndpoint*(*)())dlsym(handle, "createEndpoint");
                     if (createFunc) {
@@ -57,7 +59,7 @@ private:
                 auto it = lastWriteTimes_.find(entry.path().string());
                 
                 if (it == lastWriteTimes_.end() || it->second != currentTime) {
-                    void* handle = dlopen(entry.path().c_str(), RTLD_NOW);
+                    void* handle = loadComponent(entry.path().c_str(), RTLD_NOW);
                     if (handle) {
                         auto createFunc = (IEndpoint*(*)())dlsym(handle, "createEndpoint");
                         if (createFunc) {
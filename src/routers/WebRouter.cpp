@@ -20,7 +20,9 @@ public:
     }
 
     std::shared_ptr<IEndpoint> getEndpoint(const std::string& path) override {
-        checkForUpdates();
+        if (componentHotSwapEnabled()) {
+            checkForUpdates();
+        }
         auto it = endpoints_.find(path);
         return it != endpoints_.end() ? it->second : nullptr;
     }
@@ -33,7 +35,7 @@ private:
                 entry.path().extension() == ".dylib" ||
                 entry.path().extension() == ".dll") {
                 
-                void* handle = dlopen(entry.path().c_str(), RTLD_NOW);
+                void* handle = loadComponent(entry.path().c_str(), RTLD_NOW);
                 if (handle) {
                     auto createFunc = (IEndpoint*(*)())dlsym(handle, "createEndpoint");
                     if (createFunc) {
@@ -74,7 +76,7 @@ private:
                 
                 if (needsReload) {
                     fmt::print("Loading endpoint: {}\n", filepath);
-                    void* handle = dlopen(filepath.c_str(), RTLD_NOW | RTLD_GLOBAL);
+                    void* handle = loadComponent(filepath.c_str(), RTLD_NOW | RTLD_GLOBAL);
                     if (handle) {
                         auto createFunc = (IEndpoint*(*)())dlsym(handle, "createEndpoint");
                         if (createFunc) {